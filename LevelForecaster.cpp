@@ -0,0 +1,317 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* SUMP MONITOR v0.1                                                                                                    *
+*                                                                                                                      *
+* Copyright (c) 2020 Andrew D. Zonenberg                                                                               *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of LevelForecaster
+ */
+
+#include "sumpmon.h"
+#include "LevelForecaster.h"
+#include <cmath>
+
+using namespace std;
+
+//Fitted level must be this far (mm) past the pump start level before we consider the pump overdue
+static const double g_pumpStartHysteresis = 10;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+/**
+	@brief Creates a forecaster
+
+	@param window			Number of samples to fit the trend over
+	@param nominalPumpStart	Depth (mm) the pump is expected to start at, used until we've seen it start
+ */
+LevelForecaster::LevelForecaster(size_t window, double nominalPumpStart)
+	: m_window(window)
+	, m_count(0)
+	, m_next(0)
+	, m_times(window)
+	, m_depths(window)
+	, m_tbase(0)
+	, m_tlast(0)
+	, m_lastDepth(0)
+	, m_sumT(0)
+	, m_sumD(0)
+	, m_sumTT(0)
+	, m_sumTD(0)
+	, m_level(0)
+	, m_slope(0)
+	, m_peakLevel(-1)
+	, m_pumpStartLevel(-1)
+	, m_nominalPumpStart(nominalPumpStart)
+	, m_overdueSince(-1)
+	, m_alarmLatched(false)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Sample processing
+
+/**
+	@brief Adds a new depth measurement (in mm) taken at time t
+ */
+void LevelForecaster::AddSample(double t, double depth)
+{
+	//The poll thread may not have produced a new reading since the last call, don't count it twice
+	if( (m_count > 0) && (t == m_tlast) )
+		return;
+
+	//If the wall clock stepped backwards the old samples are on a different time axis, so start the fit over
+	if( (m_count > 0) && (t < m_tlast) )
+		Reset();
+
+	if(m_count == 0)
+		m_tbase = t;
+	double rt = t - m_tbase;
+
+	//Drop the oldest sample once the window is full
+	if(m_count == m_window)
+	{
+		double ot = m_times[m_next];
+		double od = m_depths[m_next];
+		m_sumT -= ot;
+		m_sumD -= od;
+		m_sumTT -= ot*ot;
+		m_sumTD -= ot*od;
+	}
+	else
+		m_count ++;
+
+	m_times[m_next] = rt;
+	m_depths[m_next] = depth;
+	m_sumT += rt;
+	m_sumD += depth;
+	m_sumTT += rt*rt;
+	m_sumTD += rt*depth;
+	m_next = (m_next + 1) % m_window;
+	m_tlast = t;
+	m_lastDepth = depth;
+
+	//Once per trip around the ring buffer, rebase the time origin and recompute the sums from scratch.
+	//This keeps the times small and stops rounding error from the add/subtract updates piling up.
+	if( (m_count == m_window) && (m_next == 0) )
+		RecomputeSums();
+
+	if(m_count < 2)
+		return;
+	Refit();
+
+	if(!IsValid())
+		return;
+
+	//Track the highest level seen this pump cycle
+	if(m_level > m_peakLevel)
+		m_peakLevel = m_level;
+
+	//If the level is well above where the pump normally kicks in, the pump is overdue
+	if(m_pumpStartLevel > 0)
+	{
+		if(m_level > m_pumpStartLevel + g_pumpStartHysteresis)
+		{
+			if(m_overdueSince < 0)
+				m_overdueSince = t;
+		}
+		else if(m_level < m_pumpStartLevel)
+			m_overdueSince = -1;
+	}
+}
+
+/**
+	@brief Discards all samples in the window, keeping what we've learned about the pump
+ */
+void LevelForecaster::Reset()
+{
+	m_count = 0;
+	m_next = 0;
+	m_sumT = 0;
+	m_sumD = 0;
+	m_sumTT = 0;
+	m_sumTD = 0;
+	m_overdueSince = -1;
+}
+
+/**
+	@brief Shifts the time origin to the oldest sample in the window and recalculates all of the running sums
+ */
+void LevelForecaster::RecomputeSums()
+{
+	size_t oldest = (m_count < m_window) ? 0 : m_next;
+	double shift = m_times[oldest];
+	m_tbase += shift;
+
+	m_sumT = 0;
+	m_sumD = 0;
+	m_sumTT = 0;
+	m_sumTD = 0;
+	for(size_t i=0; i<m_count; i++)
+	{
+		m_times[i] -= shift;
+		m_sumT += m_times[i];
+		m_sumD += m_depths[i];
+		m_sumTT += m_times[i] * m_times[i];
+		m_sumTD += m_times[i] * m_depths[i];
+	}
+}
+
+/**
+	@brief Solves for the least squares line through the current window and evaluates it at the newest sample
+ */
+void LevelForecaster::Refit()
+{
+	double n = m_count;
+	double denom = n*m_sumTT - m_sumT*m_sumT;
+	if(fabs(denom) < 1e-9)
+	{
+		m_slope = 0;
+		m_level = m_sumD / n;
+		return;
+	}
+
+	m_slope = (n*m_sumTD - m_sumT*m_sumD) / denom;
+	double intercept = (m_sumD - m_slope*m_sumT) / n;
+	m_level = intercept + m_slope*(m_tlast - m_tbase);
+}
+
+/**
+	@brief Called when the pump is seen to start, so we can learn the level it normally kicks in at
+ */
+void LevelForecaster::OnPumpStarted()
+{
+	if(m_peakLevel > 0)
+		m_pumpStartLevel = m_peakLevel;
+
+	m_peakLevel = -1;
+	m_overdueSince = -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Forecasting
+
+/**
+	@brief Estimates how many seconds until the water reaches the given depth
+
+	Returns a negative value if we don't have enough data yet, or the level is not rising.
+ */
+double LevelForecaster::GetTimeToLevel(double depth)
+{
+	if(!IsValid())
+		return -1;
+	if(m_level >= depth)
+		return 0;
+	if(m_slope <= 0)
+		return -1;
+
+	return (depth - m_level) / m_slope;
+}
+
+/**
+	@brief Returns how many seconds the level has been above the point where the pump should have started, or zero
+	if the pump is not overdue.
+ */
+double LevelForecaster::GetTimeSinceExpectedPumpStart()
+{
+	if(m_overdueSince < 0)
+		return 0;
+	return m_tlast - m_overdueSince;
+}
+
+/**
+	@brief Returns the depth (mm) the pump is expected to start at
+ */
+double LevelForecaster::GetPumpStartLevel()
+{
+	if(m_pumpStartLevel > 0)
+		return m_pumpStartLevel;
+	return m_nominalPumpStart;
+}
+
+/**
+	@brief Checks if the pump should be running by now, i.e. the level is clearly past the pump start level or is
+	forecast to hit the redline before reaching it.
+
+	A healthy pump cycle heads toward the redline right up until the pump kicks in, so the time to the redline only
+	means anything once this is true.
+ */
+bool LevelForecaster::PumpShouldBeRunning(double redline)
+{
+	if(!IsValid())
+		return false;
+
+	double start = GetPumpStartLevel();
+	if(m_level > start + g_pumpStartHysteresis)
+		return true;
+
+	double timeToOverflow = GetTimeToLevel(redline);
+	return (timeToOverflow >= 0) && (timeToOverflow < GetTimeToLevel(start));
+}
+
+/**
+	@brief Decides whether the trend warrants an alarm.
+
+	We alarm if the level is at the redline, if the pump should be running and the redline is forecast to be hit
+	within overflowHorizon, or if the pump is more than lateLimit overdue. Once raised, the alarm stays latched until
+	the level is clearly back below the pump start level.
+
+	@param redline			Depth (mm) considered an overflow
+	@param overflowHorizon	Alarm if the redline is forecast to be hit within this many seconds
+	@param lateLimit		Alarm if the pump is more than this many seconds overdue
+ */
+bool LevelForecaster::UpdateAlarm(double redline, double overflowHorizon, double lateLimit)
+{
+	if(m_count == 0)
+		return m_alarmLatched;
+
+	//Use the raw reading until we have enough samples for a trend
+	double level = IsValid() ? m_level : m_lastDepth;
+
+	if(m_alarmLatched)
+	{
+		if(IsValid() && (level < GetPumpStartLevel() - g_pumpStartHysteresis) )
+			m_alarmLatched = false;
+		return m_alarmLatched;
+	}
+
+	//Always alarm once we actually hit the redline
+	if(level >= redline)
+		m_alarmLatched = true;
+
+	else if(IsValid())
+	{
+		double timeToOverflow = GetTimeToLevel(redline);
+		bool overflowSoon = (timeToOverflow >= 0) && (timeToOverflow < overflowHorizon);
+		if( (overflowSoon && PumpShouldBeRunning(redline)) || (GetTimeSinceExpectedPumpStart() > lateLimit) )
+			m_alarmLatched = true;
+	}
+
+	return m_alarmLatched;
+}
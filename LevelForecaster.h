@@ -0,0 +1,110 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* SUMP MONITOR v0.1                                                                                                    *
+*                                                                                                                      *
+* Copyright (c) 2020 Andrew D. Zonenberg                                                                               *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of LevelForecaster
+ */
+
+#ifndef LevelForecaster_h
+#define LevelForecaster_h
+
+#include <cstddef>
+#include <vector>
+
+/**
+	@brief Incremental sliding-window least squares fit of water depth vs time.
+
+	Each new sample updates the running sums in O(1) so the trend is available every timer tick. From the fitted
+	level and slope we estimate how long until the redline is reached, and how long the pump is overdue (based on the
+	peak level seen before the last pump start, or a nominal level until we've seen it start). The alarm decision
+	latches so it can't flap around the thresholds.
+ */
+class LevelForecaster
+{
+public:
+	LevelForecaster(size_t window, double nominalPumpStart);
+
+	void AddSample(double t, double depth);
+	void OnPumpStarted();
+
+	bool IsValid()
+	{ return m_count >= m_window; }
+
+	//Fitted depth (mm) and rate of rise (mm/s) at the most recent sample
+	double GetLevel()
+	{ return m_level; }
+
+	double GetSlope()
+	{ return m_slope; }
+
+	double GetTimeToLevel(double depth);
+	double GetPumpStartLevel();
+	bool PumpShouldBeRunning(double redline);
+	double GetTimeSinceExpectedPumpStart();
+
+	bool UpdateAlarm(double redline, double overflowHorizon, double lateLimit);
+
+protected:
+	void Refit();
+	void RecomputeSums();
+	void Reset();
+
+	//Ring buffer of samples in the window. Times are relative to m_tbase to keep the sums well conditioned.
+	size_t m_window;
+	size_t m_count;
+	size_t m_next;
+	std::vector<double> m_times;
+	std::vector<double> m_depths;
+	double m_tbase;
+	double m_tlast;
+	double m_lastDepth;
+
+	//Running sums for the least squares fit
+	double m_sumT;
+	double m_sumD;
+	double m_sumTT;
+	double m_sumTD;
+
+	//Most recent fit
+	double m_level;
+	double m_slope;
+
+	//Pump start level learned from previous cycles (negative if not yet known), and the one to assume until then
+	double m_peakLevel;
+	double m_pumpStartLevel;
+	double m_nominalPumpStart;
+	double m_overdueSince;
+
+	//Set once the trend says we're in trouble, cleared when the level is back below the pump start level
+	bool m_alarmLatched;
+};
+
+#endif
@@ -38,6 +38,9 @@
 
 using namespace std;
 
+//Keep two weeks of history at one sample per second
+static const size_t g_historyDepth = 14 * 86400;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
 
@@ -48,7 +51,11 @@ MainWindow::MainWindow()
 	: m_depthGraph(500)
 	, m_volumeGraph(500)
 	, m_flowGraph(500)
+	, m_depthHistory(&m_depthGraph, g_historyDepth)
+	, m_volumeHistory(&m_volumeGraph, g_historyDepth)
+	, m_flowHistory(&m_flowGraph, g_historyDepth)
 	, m_alarming(false)
+	, m_forecaster(120, 180)
 {
 	set_title("Sump Monitor");
 
@@ -105,6 +112,13 @@ void MainWindow::CreateWidgets()
 					m_flowCaptionLabel.set_size_request(125, 1);
 				m_flowBox.pack_start(m_flowLabel, Gtk::PACK_SHRINK);
 					m_flowLabel.override_font(Pango::FontDescription("sans bold 20"));
+			m_summaryTab.pack_start(m_forecastBox, Gtk::PACK_SHRINK);
+				m_forecastBox.pack_start(m_forecastCaptionLabel, Gtk::PACK_SHRINK);
+					m_forecastCaptionLabel.override_font(Pango::FontDescription("sans bold 20"));
+					m_forecastCaptionLabel.set_label("Overflow: ");
+					m_forecastCaptionLabel.set_size_request(125, 1);
+				m_forecastBox.pack_start(m_forecastLabel, Gtk::PACK_SHRINK);
+					m_forecastLabel.override_font(Pango::FontDescription("sans bold 20"));
 			m_summaryTab.pack_start(m_silenceAlarmButton, Gtk::PACK_SHRINK);
 				m_silenceAlarmButton.set_label("Silence alarm");
 				m_silenceAlarmButton.signal_clicked().connect(sigc::mem_fun(*this, &MainWindow::SilenceAlarm));
@@ -173,6 +187,11 @@ void MainWindow::CreateWidgets()
 				m_flowGraph.m_font = Pango::FontDescription(font);
 		m_tabs.append_page(m_dutyTab, "Duty %");
 
+	//Let the user zoom the history graphs
+	SetupZoom(m_depthHistory);
+	SetupZoom(m_volumeHistory);
+	SetupZoom(m_flowHistory);
+
 	//Done adding widgets
 	show_all();
 }
@@ -182,29 +201,43 @@ void MainWindow::CreateWidgets()
 
 bool MainWindow::OnTimer(int /*timer*/)
 {
-	//Before we do anything else, check if any of the floor sensors are leaking and ring the alarm.
-	if(g_leakReading > 10)
+	double t = g_timeOfReading;
+	double depth = g_depth;
+	double volume = DepthToVolume(depth);
+
+	//Update the level trend so we can see trouble coming before the redline is actually hit.
+	//(Negative depth means no measurement yet)
+	if(depth >= 0)
+		m_forecaster.AddSample(t, depth);
+
+	//Alarm if the pump should be running and we're going to overflow within 5 minutes, or it's more than 2 minutes late
+	const double overflowThreshold = 300;
+	const double pumpLateThreshold = 120;
+	double timeToOverflow = m_forecaster.GetTimeToLevel(m_depthGraph.m_maxRedline);
+	double pumpLate = m_forecaster.GetTimeSinceExpectedPumpStart();
+	bool predictiveAlarm = m_forecaster.UpdateAlarm(m_depthGraph.m_maxRedline, overflowThreshold, pumpLateThreshold);
+
+	//Check if any of the floor sensors are leaking, or the forecast says we're in trouble, and ring the alarm.
+	if( (g_leakReading > 10) || predictiveAlarm )
 	{
 		if(!m_alarming)
+		{
+			if(predictiveAlarm)
+				printf("Predictive alarm: %.0f sec to overflow, pump %.0f sec late\n", timeToOverflow, pumpLate);
 			AlarmOn();
+		}
 	}
 
 	//Clear alarms if no trouble conditions
 	else if(m_alarming)
 		AlarmOff();
 
-	double t = g_timeOfReading;
-	double depth = g_depth;
-	double volume = DepthToVolume(depth);
-
 	//If we get called before the first measurement shows up, do nothing.
 	//(Negative depth is physically impossible)
 	if(depth < 0)
 		return true;
 
-	auto dseries = m_depthData.GetSeries("depth");
-	auto vseries = m_volumeData.GetSeries("volume");
-	auto fseries = m_flowData.GetSeries("flow");
+	auto& vhistory = m_volumeHistory.m_history;
 
 	//Flow is calculated in liters per hour.
 	//Use a large Gaussian window to get a more accurate estimate.
@@ -227,17 +260,16 @@ bool MainWindow::OnTimer(int /*timer*/)
 		coeffs[i] /= sum;
 
 	double flow = 0;
-	if(vseries->size() > dwindow)
+	if(vhistory.size() > dwindow)
 	{
 		double samples[dwindow];
 		double times[dwindow];
-		auto it = vseries->end();
-		it --;
-		for(size_t i=0; i<dwindow && it != vseries->begin(); i ++)
+		size_t last = vhistory.size() - 1;
+		for(size_t i=0; i<dwindow; i ++)
 		{
-			samples[i] = it->value;
-			times[i] = it->time;
-			it --;
+			auto& point = vhistory[last - i];
+			samples[i] = point.value;
+			times[i] = point.time;
 		}
 
 		double center1 = times[mid];
@@ -261,9 +293,13 @@ bool MainWindow::OnTimer(int /*timer*/)
 
 	//TODO: determine if the pump is on or not
 
-	dseries->push_back(GraphPoint(t, depth));
-	vseries->push_back(GraphPoint(t, volume));
-	fseries->push_back(GraphPoint(t, flow));
+	m_depthHistory.m_history.push_back(GraphPoint(t, depth));
+	vhistory.push_back(GraphPoint(t, volume));
+	m_flowHistory.m_history.push_back(GraphPoint(t, flow));
+
+	RefreshGraph(m_depthHistory);
+	RefreshGraph(m_volumeHistory);
+	RefreshGraph(m_flowHistory);
 
 	//Format text
 	char tmp[128];
@@ -273,6 +309,11 @@ bool MainWindow::OnTimer(int /*timer*/)
 	m_volumeLabel.set_label(tmp);
 	snprintf(tmp, sizeof(tmp), "%.1f L/hr", flow);
 	m_flowLabel.set_label(tmp);
+	if( (timeToOverflow >= 0) && m_forecaster.PumpShouldBeRunning(m_depthGraph.m_maxRedline) )
+		snprintf(tmp, sizeof(tmp), "%.0f min", timeToOverflow / 60);
+	else
+		snprintf(tmp, sizeof(tmp), "--");
+	m_forecastLabel.set_label(tmp);
 
 	//If the flow rate is positive (pump not running, water leaking in) add the current flow rate to the history
 	if(flow > 0)
@@ -288,6 +329,7 @@ bool MainWindow::OnTimer(int /*timer*/)
 	else if(!m_flowSamples.empty() && (flow < -1) )
 	{
 		printf("Pump started\n");
+		m_forecaster.OnPumpStarted();
 
 		//Figure out total memory depth.
 		//Ignore 20 sec at start and end of buffer due to interference from the pump flow
@@ -322,18 +364,128 @@ bool MainWindow::OnTimer(int /*timer*/)
 	{
 	}
 
-	//Clean out old stuff
-	size_t max_points = 10000;
-	while(dseries->size() > max_points)
-		dseries->erase(dseries->begin());
-	while(vseries->size() > max_points)
-		vseries->erase(vseries->begin());
-	while(fseries->size() > max_points)
-		fseries->erase(fseries->begin());
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Graph zooming
+
+/**
+	@brief Hooks up scroll wheel and pinch zoom for a history graph
+ */
+void MainWindow::SetupZoom(HistoryGraph& hist)
+{
+	Graph* graph = hist.m_graph;
+
+	//Reload the on-screen data as soon as the graph gets its real size (e.g. when its tab is first shown)
+	graph->signal_size_allocate().connect(
+		sigc::bind(sigc::mem_fun(*this, &MainWindow::OnGraphResized), &hist));
+
+	graph->add_events(Gdk::SCROLL_MASK | Gdk::SMOOTH_SCROLL_MASK | Gdk::TOUCH_MASK);
+	graph->signal_scroll_event().connect(
+		sigc::bind(sigc::mem_fun(*this, &MainWindow::OnGraphScroll), &hist), false);
+
+	hist.m_pinch = Gtk::GestureZoom::create(*graph);
+	hist.m_pinch->signal_begin().connect(
+		sigc::bind(sigc::mem_fun(*this, &MainWindow::OnPinchBegin), &hist));
+	hist.m_pinch->signal_scale_changed().connect(
+		sigc::bind(sigc::mem_fun(*this, &MainWindow::OnPinchScaleChanged), &hist));
+}
+
+/**
+	@brief Changes the time scale (pixels per second) of a history graph and redraws it
+ */
+void MainWindow::SetTimeScale(HistoryGraph& hist, double scale)
+{
+	Graph* graph = hist.m_graph;
+	double width = max(graph->get_allocated_width(), 1);
+
+	//Don't zoom out past the retained history, or in past a couple of pixels per sample
+	double minScale = width / g_historyDepth;
+	double maxScale = 2;
+	scale = max(minScale, min(maxScale, scale));
+	graph->m_timeScale = scale;
+
+	//Pick a tick interval that keeps the gridlines about 90 pixels apart
+	static const double ticks[] = { 60, 300, 600, 1200, 1800, 3600, 7200, 14400, 21600, 43200, 86400, 172800, 604800 };
+	const size_t nticks = sizeof(ticks) / sizeof(ticks[0]);
+	double tick = ticks[nticks - 1];
+	for(size_t i=0; i<nticks; i++)
+	{
+		if(ticks[i] * scale >= 90)
+		{
+			tick = ticks[i];
+			break;
+		}
+	}
+	graph->m_timeTick = tick;
+
+	RefreshGraph(hist);
+	graph->queue_draw();
+}
+
+/**
+	@brief Reloads the on-screen series of a graph from its history, decimated to about one point per pixel
+ */
+void MainWindow::RefreshGraph(HistoryGraph& hist)
+{
+	auto& history = hist.m_history;
+	if(history.empty())
+		return;
+
+	Graph* graph = hist.m_graph;
+	size_t width = max(graph->get_allocated_width(), 1);
+	double tend = history[history.size() - 1].time;
+	double tstart = tend - width / graph->m_timeScale;
+
+	auto series = graph->m_series[0]->GetSeries(graph->m_seriesName);
+	series->clear();
+	for(auto& point : history.Query(tstart, tend, width))
+		series->push_back(point);
+}
+
+bool MainWindow::OnGraphScroll(GdkEventScroll* ev, HistoryGraph* hist)
+{
+	const double step = 1.25;
+	double scale = hist->m_graph->m_timeScale;
+
+	switch(ev->direction)
+	{
+		case GDK_SCROLL_UP:
+			scale *= step;
+			break;
+
+		case GDK_SCROLL_DOWN:
+			scale /= step;
+			break;
+
+		case GDK_SCROLL_SMOOTH:
+			scale *= pow(step, -ev->delta_y);
+			break;
 
+		default:
+			return false;
+	}
+
+	SetTimeScale(*hist, scale);
 	return true;
 }
 
+void MainWindow::OnGraphResized(Gtk::Allocation& /*alloc*/, HistoryGraph* hist)
+{
+	RefreshGraph(*hist);
+}
+
+void MainWindow::OnPinchBegin(GdkEventSequence* /*seq*/, HistoryGraph* hist)
+{
+	hist->m_pinchStartScale = hist->m_graph->m_timeScale;
+}
+
+void MainWindow::OnPinchScaleChanged(double scale, HistoryGraph* hist)
+{
+	SetTimeScale(*hist, hist->m_pinchStartScale * scale);
+}
+
 void MainWindow::AlarmOn()
 {
 	m_alarming = true;
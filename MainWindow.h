@@ -37,6 +37,26 @@
 #define MainWindow_h
 
 #include "graphwidget/Graph.h"
+#include "LevelForecaster.h"
+#include "SampleHistory.h"
+
+/**
+	@brief A graph whose on-screen data is pulled from a SampleHistory, plus its zoom state
+ */
+struct HistoryGraph
+{
+	HistoryGraph(Graph* graph, size_t maxSamples)
+		: m_graph(graph)
+		, m_history(maxSamples)
+		, m_pinchStartScale(0)
+	{}
+
+	Graph* m_graph;
+	SampleHistory m_history;
+
+	Glib::RefPtr<Gtk::GestureZoom> m_pinch;
+	double m_pinchStartScale;
+};
 
 /**
 	@brief Main application window class for a sump pump
@@ -64,6 +84,9 @@ protected:
 			Gtk::HBox m_flowBox;
 				Gtk::Label m_flowCaptionLabel;
 				Gtk::Label m_flowLabel;
+			Gtk::HBox m_forecastBox;
+				Gtk::Label m_forecastCaptionLabel;
+				Gtk::Label m_forecastLabel;
 			Gtk::Button m_silenceAlarmButton;
 			Gtk::Frame m_trendFrame;
 				Graph m_trendGraph;
@@ -81,11 +104,28 @@ protected:
 
 	bool OnTimer(int timer);
 
+	//Full history behind each graph (the Graphable only holds what's currently on screen)
+	HistoryGraph m_depthHistory;
+	HistoryGraph m_volumeHistory;
+	HistoryGraph m_flowHistory;
+
+	void SetupZoom(HistoryGraph& hist);
+	void SetTimeScale(HistoryGraph& hist, double scale);
+	void RefreshGraph(HistoryGraph& hist);
+	bool OnGraphScroll(GdkEventScroll* ev, HistoryGraph* hist);
+	void OnPinchBegin(GdkEventSequence* seq, HistoryGraph* hist);
+	void OnPinchScaleChanged(double scale, HistoryGraph* hist);
+	void OnGraphResized(Gtk::Allocation& alloc, HistoryGraph* hist);
+
 	bool m_alarming;
 	void AlarmOn();
 	void AlarmOff();
 	void SilenceAlarm();
 
+	//Trend of the depth data, used to raise an alarm before the redline is actually reached.
+	//Pump start depth is hard coded for now, until the forecaster has seen the pump start for itself.
+	LevelForecaster m_forecaster;
+
 	//Flow rate samples since the last time the pump ran
 	std::vector<double> m_flowSamples;
 };
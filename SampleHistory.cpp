@@ -0,0 +1,259 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* SUMP MONITOR v0.1                                                                                                    *
+*                                                                                                                      *
+* Copyright (c) 2020 Andrew D. Zonenberg                                                                               *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Implementation of SampleHistory
+ */
+
+#include "sumpmon.h"
+#include "SampleHistory.h"
+#include <algorithm>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+/**
+	@brief Creates an empty history which retains (at least) the most recent maxSamples points
+ */
+SampleHistory::SampleHistory(size_t maxSamples)
+	: m_size(0)
+	, m_maxBlocks((maxSamples + BLOCK_SIZE - 1) / BLOCK_SIZE + 1)
+	, m_firstIndex(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Sample storage
+
+/**
+	@brief Appends a new sample.
+
+	The range lookups depend on the history being sorted by time. If the wall clock steps backwards, the existing
+	history is shifted back to line up with the new sample rather than dropping samples until the clock catches up.
+ */
+void SampleHistory::push_back(const GraphPoint& point)
+{
+	if(!m_blocks.empty() && (point.time < m_blocks.back().back().time) )
+		ShiftTimes(point.time - m_blocks.back().back().time);
+
+	//Start a new block if the current one is full
+	if(m_blocks.empty() || (m_blocks.back().size() == BLOCK_SIZE) )
+	{
+		m_blocks.push_back(vector<GraphPoint>());
+		m_blocks.back().reserve(BLOCK_SIZE);
+		m_blockStart.push_back(point.time);
+		m_blockMin.push_back(point);
+		m_blockMax.push_back(point);
+	}
+	else if(point.value < m_blockMin.back().value)
+		m_blockMin.back() = point;
+	else if(point.value > m_blockMax.back().value)
+		m_blockMax.back() = point;
+
+	m_blocks.back().push_back(point);
+	m_size ++;
+
+	//Clean out old stuff
+	while(m_blocks.size() > m_maxBlocks)
+	{
+		m_size -= m_blocks.front().size();
+		m_firstIndex += m_blocks.front().size();
+		m_blocks.pop_front();
+		m_blockStart.pop_front();
+		m_blockMin.pop_front();
+		m_blockMax.pop_front();
+	}
+}
+
+/**
+	@brief Adds delta to the timestamp of every sample.
+
+	This touches the whole history, but only happens when the wall clock is stepped.
+ */
+void SampleHistory::ShiftTimes(double delta)
+{
+	for(auto& block : m_blocks)
+	{
+		for(auto& point : block)
+			point.time += delta;
+	}
+	for(auto& t : m_blockStart)
+		t += delta;
+	for(auto& point : m_blockMin)
+		point.time += delta;
+	for(auto& point : m_blockMax)
+		point.time += delta;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Range queries
+
+/**
+	@brief Returns the index of the first sample with timestamp >= t
+ */
+size_t SampleHistory::LowerBound(double t)
+{
+	if(m_blocks.empty())
+		return 0;
+
+	//Samples at time t can't be in any block before the last one that starts before t
+	auto it = lower_bound(m_blockStart.begin(), m_blockStart.end(), t);
+	if(it != m_blockStart.begin())
+		it --;
+	size_t block = it - m_blockStart.begin();
+
+	auto& b = m_blocks[block];
+	auto jt = lower_bound(b.begin(), b.end(), t,
+		[](const GraphPoint& p, double x) { return p.time < x; });
+	return block*BLOCK_SIZE + (jt - b.begin());
+}
+
+/**
+	@brief Returns the index of the first sample with timestamp > t
+ */
+size_t SampleHistory::UpperBound(double t)
+{
+	if(m_blocks.empty())
+		return 0;
+
+	auto it = upper_bound(m_blockStart.begin(), m_blockStart.end(), t);
+	if(it != m_blockStart.begin())
+		it --;
+	size_t block = it - m_blockStart.begin();
+
+	auto& b = m_blocks[block];
+	auto jt = upper_bound(b.begin(), b.end(), t,
+		[](double x, const GraphPoint& p) { return x < p.time; });
+	return block*BLOCK_SIZE + (jt - b.begin());
+}
+
+/**
+	@brief Returns the samples between t0 and t1 (inclusive), decimated to no more than max_points.
+
+	Decimation keeps every Nth sample, so the cost is proportional to the number of points returned rather than the
+	length of the range. N is rounded up to a power of two and samples are picked by absolute index, so the same
+	samples are returned as the range slides forward and a live graph doesn't shimmer from one update to the next.
+
+	Once N reaches a whole block, picking single samples would skip over short events like a pump cycle, so instead we
+	return the min and max of each group of N samples using the per-block min/max.
+ */
+vector<GraphPoint> SampleHistory::Query(double t0, double t1, size_t max_points)
+{
+	vector<GraphPoint> ret;
+	if(max_points == 0)
+		return ret;
+
+	size_t start = LowerBound(t0);
+	size_t end = UpperBound(t1);
+	if(end <= start)
+		return ret;
+
+	size_t n = end - start;
+	size_t stride = 1;
+	while(stride * max_points < n)
+		stride *= 2;
+
+	//Zoomed out far enough to work in whole blocks? Return the envelope, two points per bucket
+	if( (stride >= BLOCK_SIZE) && (max_points >= 4) )
+	{
+		while(stride * (max_points/2 - 1) < n)
+			stride *= 2;
+
+		//Buckets are aligned to absolute indexes, like the decimated samples
+		size_t astart = m_firstIndex + start;
+		size_t aend = m_firstIndex + end;
+		ret.reserve(2 * (n / stride + 2));
+		for(size_t bucket = astart / stride * stride; bucket < aend; bucket += stride)
+		{
+			AppendEnvelope(
+				max(bucket, astart) - m_firstIndex,
+				min(bucket + stride, aend) - m_firstIndex,
+				ret);
+		}
+		return ret;
+	}
+
+	//Round the first index up to a multiple of the stride
+	size_t first = (m_firstIndex + start + stride - 1) / stride * stride - m_firstIndex;
+
+	//If the stride is longer than the range there may be no multiple of it in range, return one sample anyway
+	if(first >= end)
+		first = start;
+
+	ret.reserve(n / stride + 1);
+	for(size_t i = first; i < end; i += stride)
+		ret.push_back((*this)[i]);
+	return ret;
+}
+
+/**
+	@brief Appends the lowest and highest samples in [start, end) to out, in time order.
+
+	Whole blocks are covered by their stored min/max, so only partial blocks at the ends of the range are scanned.
+ */
+void SampleHistory::AppendEnvelope(size_t start, size_t end, vector<GraphPoint>& out)
+{
+	GraphPoint lo = (*this)[start];
+	GraphPoint hi = lo;
+
+	for(size_t i = start; i < end; )
+	{
+		size_t block = i / BLOCK_SIZE;
+		size_t blockEnd = (block + 1) * BLOCK_SIZE;
+
+		if( (i % BLOCK_SIZE == 0) && (blockEnd <= end) )
+		{
+			if(m_blockMin[block].value < lo.value)
+				lo = m_blockMin[block];
+			if(m_blockMax[block].value > hi.value)
+				hi = m_blockMax[block];
+			i = blockEnd;
+			continue;
+		}
+
+		for(; (i < end) && (i < blockEnd); i++)
+		{
+			auto& point = (*this)[i];
+			if(point.value < lo.value)
+				lo = point;
+			if(point.value > hi.value)
+				hi = point;
+		}
+	}
+
+	if(hi.time < lo.time)
+		swap(lo, hi);
+	out.push_back(lo);
+	if( (hi.time != lo.time) || (hi.value != lo.value) )
+		out.push_back(hi);
+}
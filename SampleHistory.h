@@ -0,0 +1,95 @@
+/***********************************************************************************************************************
+*                                                                                                                      *
+* SUMP MONITOR v0.1                                                                                                    *
+*                                                                                                                      *
+* Copyright (c) 2020 Andrew D. Zonenberg                                                                               *
+* All rights reserved.                                                                                                 *
+*                                                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are permitted provided that the     *
+* following conditions are met:                                                                                        *
+*                                                                                                                      *
+*    * Redistributions of source code must retain the above copyright notice, this list of conditions, and the         *
+*      following disclaimer.                                                                                           *
+*                                                                                                                      *
+*    * Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the       *
+*      following disclaimer in the documentation and/or other materials provided with the distribution.                *
+*                                                                                                                      *
+*    * Neither the name of the author nor the names of any contributors may be used to endorse or promote products     *
+*      derived from this software without specific prior written permission.                                           *
+*                                                                                                                      *
+* THIS SOFTWARE IS PROVIDED BY THE AUTHORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED   *
+* TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL *
+* THE AUTHORS BE HELD LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES        *
+* (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR       *
+* BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT *
+* (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE       *
+* POSSIBILITY OF SUCH DAMAGE.                                                                                          *
+*                                                                                                                      *
+***********************************************************************************************************************/
+
+/**
+	@file
+	@author Andrew D. Zonenberg
+	@brief Declaration of SampleHistory
+ */
+
+#ifndef SampleHistory_h
+#define SampleHistory_h
+
+#include <deque>
+#include <vector>
+#include "graphwidget/Graph.h"
+
+/**
+	@brief Long-term storage of a time series, indexed for fast time-range lookups.
+
+	Samples are stored in fixed-size blocks, and we keep a sparse index of the first timestamp in each block. A range
+	query binary searches the index to find the starting block, then the block itself, so lookups don't depend on how
+	much history is retained. Each block also records its min and max, so zoomed-out queries can return the envelope
+	of the data without touching every sample. Old samples are discarded a whole block at a time so every block but
+	the last is full, which lets us address any sample by index.
+ */
+class SampleHistory
+{
+public:
+	SampleHistory(size_t maxSamples);
+
+	void push_back(const GraphPoint& point);
+
+	size_t size()
+	{ return m_size; }
+
+	bool empty()
+	{ return m_size == 0; }
+
+	const GraphPoint& operator[](size_t i)
+	{ return m_blocks[i / BLOCK_SIZE][i % BLOCK_SIZE]; }
+
+	std::vector<GraphPoint> Query(double t0, double t1, size_t max_points);
+
+protected:
+	size_t LowerBound(double t);
+	size_t UpperBound(double t);
+	void AppendEnvelope(size_t start, size_t end, std::vector<GraphPoint>& out);
+	void ShiftTimes(double delta);
+
+	static const size_t BLOCK_SIZE = 1024;
+
+	//The sample data
+	std::deque< std::vector<GraphPoint> > m_blocks;
+
+	//Timestamp of the first sample in each block
+	std::deque<double> m_blockStart;
+
+	//Lowest and highest sample in each block
+	std::deque<GraphPoint> m_blockMin;
+	std::deque<GraphPoint> m_blockMax;
+
+	size_t m_size;
+	size_t m_maxBlocks;
+
+	//Number of samples discarded from the front so far, i.e. the absolute index of sample 0
+	size_t m_firstIndex;
+};
+
+#endif